@@ -51,6 +51,9 @@ for k,version in ipairs(spine_versions) do
             removefiles {
                 "src/spine-glfw.cpp", "src/spine-glfw.h", 
                 "src/SpineManager.cpp", "src/SpineManager.h",
+                "src/SpineArena.cpp", "src/SpineArena.h",
+                "src/SkeletonCache.cpp", "src/SkeletonCache.h",
+                "src/AssetPackage.cpp", "src/AssetPackage.h",
                 "src/main.cpp",
             }
         else
@@ -89,7 +92,7 @@ for k,version in ipairs(spine_versions) do
         filter "system:windows"
             includedirs { "vendor/glfw/win32/include" }
             libdirs { "vendor/glfw/win32/lib-vc2019" }
-            links { "glfw3.lib", "opengl32.lib", "gdi32.lib", "user32.lib", "shell32.lib" }
+            links { "glfw3.lib", "opengl32.lib", "gdi32.lib", "user32.lib", "shell32.lib", "psapi.lib" }
         filter "system:linux"
             links {
                 "glfw3",
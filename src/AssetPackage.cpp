@@ -0,0 +1,266 @@
+#include "AssetPackage.h"
+
+#if SPINE_MAJOR_VERSION >= 4
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stb_image.h"
+
+using spine::SkeletonJsonConverter;
+using spine::SpineExtension;
+
+static const char MAGIC[8] = {'S', 'P', 'I', 'N', 'E', 'P', 'K', 'G'};
+static const uint32_t FORMAT_VERSION = 1;
+static const size_t HEADER_SIZE = 64;
+static const size_t PAGE_ENTRY_SIZE = 48;
+
+static std::string parentDirectory(const std::string &path) {
+    size_t slash = path.find_last_of("/\\");
+    if (slash == std::string::npos) return ".";
+    return slash == 0 ? path.substr(0, 1) : path.substr(0, slash);
+}
+
+static uint64_t align16(uint64_t offset) {
+    return (offset + 15) & ~(uint64_t) 15;
+}
+
+static void putU32(unsigned char *p, uint32_t value) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char) (value >> (i * 8));
+}
+
+static void putU64(unsigned char *p, uint64_t value) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char) (value >> (i * 8));
+}
+
+static uint32_t getU32(const unsigned char *p) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) value = value << 8 | p[i];
+    return value;
+}
+
+static uint64_t getU64(const unsigned char *p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = value << 8 | p[i];
+    return value;
+}
+
+namespace {
+    /// A section to write and where it goes in the file.
+    struct Section {
+        const unsigned char *data;
+        uint64_t size;
+        uint64_t offset;
+    };
+
+    struct PageImage {
+        std::string name;
+        int width, height, channels;
+        unsigned char *pixels;
+    };
+}
+
+bool AssetPackage::write(const std::string &atlasPath, const std::string &skelPath, const std::string &packagePath)
+{
+    error.clear();
+    int atlasTextLength = 0;
+    char *atlasText = SpineExtension::readFile(atlasPath.c_str(), &atlasTextLength);
+    if (!atlasText) {
+        error = "Failed to read atlas: " + atlasPath;
+        return false;
+    }
+    int skelLength = 0;
+    char *skel = SpineExtension::readFile(skelPath.c_str(), &skelLength);
+    if (!skel) {
+        SpineExtension::free(atlasText, __FILE__, __LINE__);
+        error = "Failed to read skeleton file: " + skelPath;
+        return false;
+    }
+
+    // JSON is stored as its binary conversion, so loading never parses JSON.
+    SkeletonJsonConverter converter;
+    const unsigned char *binary = (const unsigned char *) skel;
+    int binaryLength = skelLength;
+    if (skelPath.find(".json") != std::string::npos) {
+        if (!converter.convert(skel, skelLength, SkeletonJsonConverter::contentHash(skel, skelLength))) {
+            error = std::string("Can't convert ") + skelPath + " to binary: " + converter.getError().buffer();
+            SpineExtension::free(atlasText, __FILE__, __LINE__);
+            SpineExtension::free(skel, __FILE__, __LINE__);
+            return false;
+        }
+        binary = converter.getBinary();
+        binaryLength = converter.getBinaryLength();
+    }
+
+    // Only the page names and image paths are needed, no textures are created.
+    std::vector<PageImage> images;
+    {
+        spine::Atlas pageAtlas(atlasText, atlasTextLength, parentDirectory(atlasPath).c_str(), nullptr, false);
+        spine::Vector<spine::AtlasPage *> &atlasPages = pageAtlas.getPages();
+        for (size_t i = 0; i < atlasPages.size() && error.empty(); i++) {
+            PageImage image;
+            image.name = atlasPages[i]->name.buffer();
+            const char *imagePath = atlasPages[i]->texturePath.buffer();
+            image.pixels = stbi_load(imagePath, &image.width, &image.height, &image.channels, 0);
+            // Textures are uploaded as red, RGB or RGBA.
+            if (image.pixels && image.channels == 2) {
+                stbi_image_free(image.pixels);
+                image.pixels = stbi_load(imagePath, &image.width, &image.height, &image.channels, 4);
+                image.channels = 4;
+            }
+            if (image.pixels)
+                images.push_back(image);
+            else
+                error = std::string("Failed to decode atlas page: ") + imagePath;
+        }
+    }
+
+    bool written = false;
+    if (error.empty()) {
+        // The header and page table, then the names, the atlas, the skeleton and the pixels.
+        std::vector<unsigned char> head(HEADER_SIZE + images.size() * PAGE_ENTRY_SIZE, 0);
+        std::vector<Section> sections;
+        uint64_t offset = head.size();
+        for (size_t i = 0; i < images.size(); i++) {
+            sections.push_back({(const unsigned char *) images[i].name.c_str(), images[i].name.size(), 0});
+        }
+        sections.push_back({(const unsigned char *) atlasText, (uint64_t) atlasTextLength, 0});
+        sections.push_back({binary, (uint64_t) binaryLength, 0});
+        for (size_t i = 0; i < images.size(); i++) {
+            sections.push_back({images[i].pixels,
+                                (uint64_t) images[i].width * images[i].height * images[i].channels, 0});
+        }
+        for (size_t i = 0; i < sections.size(); i++) {
+            offset = align16(offset);
+            sections[i].offset = offset;
+            offset += sections[i].size;
+        }
+
+        const Section &atlasSection = sections[images.size()], &skeletonSection = sections[images.size() + 1];
+        memcpy(head.data(), MAGIC, sizeof(MAGIC));
+        putU32(&head[8], FORMAT_VERSION);
+        putU32(&head[12], (uint32_t) images.size());
+        putU64(&head[16], skeletonSection.offset);
+        putU64(&head[24], skeletonSection.size);
+        putU64(&head[32], atlasSection.offset);
+        putU64(&head[40], atlasSection.size);
+        putU64(&head[48], HEADER_SIZE);
+        putU64(&head[56], images.size() * PAGE_ENTRY_SIZE);
+        for (size_t i = 0; i < images.size(); i++) {
+            unsigned char *entry = &head[HEADER_SIZE + i * PAGE_ENTRY_SIZE];
+            const Section &name = sections[i], &pixels = sections[images.size() + 2 + i];
+            putU64(entry, name.offset);
+            putU64(entry + 8, name.size);
+            putU64(entry + 16, pixels.offset);
+            putU64(entry + 24, pixels.size);
+            putU32(entry + 32, (uint32_t) images[i].width);
+            putU32(entry + 36, (uint32_t) images[i].height);
+            putU32(entry + 40, (uint32_t) images[i].channels);
+        }
+
+        // Written next to the package and renamed, so a concurrent load never sees a partial file.
+        std::string temp = packagePath + ".tmp";
+        FILE *out = fopen(temp.c_str(), "wb");
+        if (out) {
+            static const unsigned char padding[16] = {0};
+            written = fwrite(head.data(), 1, head.size(), out) == head.size();
+            uint64_t position = head.size();
+            for (size_t i = 0; i < sections.size() && written; i++) {
+                size_t pad = (size_t) (sections[i].offset - position);
+                written = fwrite(padding, 1, pad, out) == pad &&
+                          fwrite(sections[i].data, 1, (size_t) sections[i].size, out) == sections[i].size;
+                position = sections[i].offset + sections[i].size;
+            }
+            written = fclose(out) == 0 && written;
+            if (written && rename(temp.c_str(), packagePath.c_str()) != 0) {
+                // Windows doesn't replace existing files.
+                remove(packagePath.c_str());
+                written = rename(temp.c_str(), packagePath.c_str()) == 0;
+            }
+            if (!written) remove(temp.c_str());
+        }
+        if (!written) error = "Failed to write asset package: " + packagePath;
+    }
+
+    for (size_t i = 0; i < images.size(); i++) stbi_image_free(images[i].pixels);
+    SpineExtension::free(atlasText, __FILE__, __LINE__);
+    SpineExtension::free(skel, __FILE__, __LINE__);
+    return written;
+}
+
+bool AssetPackage::open(const std::string &packagePath)
+{
+    close();
+    error.clear();
+    // Not sequential, lazy animations and skins are read from the skeleton section later.
+    if (!file.open(packagePath.c_str(), false)) {
+        error = "Failed to read asset package: " + packagePath;
+        return false;
+    }
+    const unsigned char *data = file.getData();
+    uint64_t size = file.getSize();
+    if (size < HEADER_SIZE || memcmp(data, MAGIC, sizeof(MAGIC)) != 0 || getU32(data + 8) != FORMAT_VERSION) {
+        close();
+        error = "Not an asset package of this version: " + packagePath;
+        return false;
+    }
+
+    // Every section must lie within the file, so a truncated or corrupt package fails here rather than when read.
+    auto inFile = [size](uint64_t offset, uint64_t length) { return offset <= size && length <= size - offset; };
+    uint32_t pageCount = getU32(data + 12);
+    uint64_t skeletonOffset = getU64(data + 16), skeletonSize = getU64(data + 24);
+    uint64_t atlasOffset = getU64(data + 32), atlasSize = getU64(data + 40);
+    uint64_t tableOffset = getU64(data + 48), tableSize = getU64(data + 56);
+    bool valid = inFile(skeletonOffset, skeletonSize) && skeletonSize <= INT_MAX && inFile(atlasOffset, atlasSize) &&
+                 atlasSize <= INT_MAX && inFile(tableOffset, tableSize) &&
+                 tableSize >= (uint64_t) pageCount * PAGE_ENTRY_SIZE;
+    for (uint32_t i = 0; i < pageCount && valid; i++) {
+        const unsigned char *entry = data + tableOffset + i * PAGE_ENTRY_SIZE;
+        uint64_t nameOffset = getU64(entry), nameSize = getU64(entry + 8);
+        uint64_t pixelsOffset = getU64(entry + 16), pixelsSize = getU64(entry + 24);
+        Page page;
+        page.width = (int) getU32(entry + 32);
+        page.height = (int) getU32(entry + 36);
+        page.channels = (int) getU32(entry + 40);
+        valid = inFile(nameOffset, nameSize) && inFile(pixelsOffset, pixelsSize) && page.width > 0 &&
+                page.height > 0 && (page.channels == 1 || page.channels == 3 || page.channels == 4) &&
+                pixelsSize >= (uint64_t) page.width * page.height * page.channels;
+        page.name = (const char *) data + nameOffset;
+        page.nameLength = (size_t) nameSize;
+        page.pixels = data + pixelsOffset;
+        pages.push_back(page);
+    }
+    if (!valid) {
+        close();
+        error = "Corrupt asset package: " + packagePath;
+        return false;
+    }
+    skeleton = data + skeletonOffset;
+    skeletonLength = (int) skeletonSize;
+    atlas = (const char *) data + atlasOffset;
+    atlasLength = (int) atlasSize;
+    return true;
+}
+
+void AssetPackage::close()
+{
+    file.close();
+    skeleton = nullptr;
+    skeletonLength = 0;
+    atlas = nullptr;
+    atlasLength = 0;
+    pages.clear();
+}
+
+const AssetPackage::Page *AssetPackage::findPage(const spine::String &name) const
+{
+    for (size_t i = 0; i < pages.size(); i++) {
+        const Page &page = pages[i];
+        if (page.nameLength == name.length() && memcmp(page.name, name.buffer(), page.nameLength) == 0) return &page;
+    }
+    return nullptr;
+}
+
+#endif
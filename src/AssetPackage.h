@@ -0,0 +1,66 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "spine/spine.h"
+#include "spine/Version.h"
+
+#if SPINE_MAJOR_VERSION >= 4
+
+/// A skeleton binary, its atlas and the decoded pixels of the atlas pages in one file, so loading maps the file and
+/// uploads the pixels instead of decoding images or parsing JSON. Sections are addressed by offsets from the start of
+/// the file, which makes it position independent: it is read in place through one MappedFile and processes that open
+/// the same package share its pages.
+///
+/// Layout, integers are little endian and sections start on 16 byte boundaries:
+/// - header: "SPINEPKG", u32 format version, u32 page count, then u64 offset and u64 size of the skeleton binary,
+///   the atlas text and the page table
+/// - page table: per page the u64 offset and u64 size of its name and of its pixels, then u32 width, height,
+///   channels and a zero
+class AssetPackage {
+public:
+    /// A decoded atlas page image, rows of width * channels bytes from the top row down.
+    struct Page {
+        const char *name;
+        size_t nameLength;
+        int width;
+        int height;
+        int channels;
+        const unsigned char *pixels;
+    };
+
+    /// Writes a package for the atlas and skeleton, converting a JSON skeleton to binary and decoding the page images.
+    bool write(const std::string &atlasPath, const std::string &skelPath, const std::string &packagePath);
+
+    /// Maps the package and checks that its sections lie within the file. Closes the previous package.
+    bool open(const std::string &packagePath);
+
+    /// The skeleton data and atlas read from the package must be deleted first.
+    void close();
+
+    const unsigned char *getSkeleton() const { return skeleton; }
+
+    int getSkeletonLength() const { return skeletonLength; }
+
+    const char *getAtlas() const { return atlas; }
+
+    int getAtlasLength() const { return atlasLength; }
+
+    /// The page with the name of an AtlasPage, nullptr if the package doesn't have it.
+    const Page *findPage(const spine::String &name) const;
+
+    const std::string &getError() const { return error; }
+
+private:
+    spine::MappedFile file;
+    const unsigned char *skeleton = nullptr;
+    int skeletonLength = 0;
+    const char *atlas = nullptr;
+    int atlasLength = 0;
+    std::vector<Page> pages;
+    std::string error;
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "SkeletonCache.h"
+
+#if SPINE_MAJOR_VERSION >= 4
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+using spine::SkeletonJsonConverter;
+using spine::SpineExtension;
+
+static std::string parentDirectory(const std::string &path) {
+    size_t slash = path.find_last_of("/\\");
+    if (slash == std::string::npos) return ".";
+    return slash == 0 ? path.substr(0, 1) : path.substr(0, slash);
+}
+
+static std::string fileStem(const std::string &path) {
+    size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    return dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+}
+
+static bool endsWith(const std::string &value, const char *suffix) {
+    size_t length = strlen(suffix);
+    return value.size() >= length && value.compare(value.size() - length, length, suffix) == 0;
+}
+
+static bool makeDirectory(const std::string &path) {
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+/// Creates the directory and any missing parents.
+static bool makeDirectories(const std::string &path) {
+    for (size_t i = 1; i < path.size(); i++) {
+        if ((path[i] == '/' || path[i] == '\\') && path[i - 1] != ':' && path[i - 1] != '/' && path[i - 1] != '\\') {
+            makeDirectory(path.substr(0, i));
+        }
+    }
+    return makeDirectory(path);
+}
+
+/// Adds the .json files below the directory to files. Hidden files and directories, like the default cache
+/// directories, are skipped.
+static bool listJsonFiles(const std::string &directory, std::vector<std::string> &files) {
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE) return false;
+    do {
+        std::string name = entry.cFileName;
+        if (name[0] == '.') continue;
+        std::string path = directory + "\\" + name;
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            listJsonFiles(path, files);
+        } else if (endsWith(name, ".json")) {
+            files.push_back(path);
+        }
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    DIR *dir = opendir(directory.c_str());
+    if (!dir) return false;
+    while (struct dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name[0] == '.') continue;
+        std::string path = directory + "/" + name;
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) continue;
+        if (S_ISDIR(info.st_mode)) {
+            listJsonFiles(path, files);
+        } else if (endsWith(name, ".json")) {
+            files.push_back(path);
+        }
+    }
+    closedir(dir);
+#endif
+    return true;
+}
+
+SkeletonCache::SkeletonCache(const std::string &directory) : directory(directory)
+{
+}
+
+std::string SkeletonCache::entryPath(const std::string &jsonPath, unsigned long long hash) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "-%016llx-%s.skel", hash, SPINE_VERSION_STRING);
+    std::string dir = directory.empty() ? parentDirectory(jsonPath) + "/.spinecache" : directory;
+    return dir + "/" + fileStem(jsonPath) + name;
+}
+
+unsigned char *SkeletonCache::load(const std::string &jsonPath, const char *json, int length, int *binaryLength)
+{
+    error.clear();
+    unsigned long long hash = SkeletonJsonConverter::contentHash(json, length);
+    std::string path = entryPath(jsonPath, hash);
+    unsigned char *binary = readEntry(path, hash, binaryLength);
+    if (binary) return binary;
+
+    if (!convert(jsonPath, json, length, hash)) return nullptr;
+    // A cache that can't be written only costs the next load a conversion.
+    if (!writeEntry(path, converter.getBinary(), converter.getBinaryLength())) {
+        std::cerr << error << std::endl;
+        error.clear();
+    }
+    *binaryLength = converter.getBinaryLength();
+    binary = SpineExtension::alloc<unsigned char>(*binaryLength, __FILE__, __LINE__);
+    memcpy(binary, converter.getBinary(), *binaryLength);
+    return binary;
+}
+
+bool SkeletonCache::prewarm(const std::string &jsonPath, bool *converted)
+{
+    error.clear();
+    *converted = false;
+    int length = 0;
+    char *json = SpineExtension::readFile(jsonPath.c_str(), &length);
+    if (!json) {
+        error = "Failed to read skeleton file: " + jsonPath;
+        return false;
+    }
+    unsigned long long hash = SkeletonJsonConverter::contentHash(json, length);
+    std::string path = entryPath(jsonPath, hash);
+    int binaryLength = 0;
+    unsigned char *binary = readEntry(path, hash, &binaryLength);
+    bool prewarmed = binary != nullptr;
+    if (binary) {
+        SpineExtension::free(binary, __FILE__, __LINE__);
+    } else if (convert(jsonPath, json, length, hash)) {
+        prewarmed = writeEntry(path, converter.getBinary(), converter.getBinaryLength());
+        *converted = prewarmed;
+    }
+    SpineExtension::free(json, __FILE__, __LINE__);
+    return prewarmed;
+}
+
+int SkeletonCache::prewarmDirectory(const std::string &assetDirectory)
+{
+    std::vector<std::string> files;
+    if (!listJsonFiles(assetDirectory, files)) {
+        std::cerr << "Failed to read directory: " << assetDirectory << std::endl;
+        return -1;
+    }
+    std::sort(files.begin(), files.end());
+
+    int converted = 0, cached = 0, failed = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        bool written;
+        if (!prewarm(files[i], &written)) {
+            std::cerr << "Skipped " << files[i] << ": " << error << std::endl;
+            failed++;
+        } else if (written) {
+            std::cout << "Cached " << files[i] << " (" << converter.getBinaryLength() / 1024 << " KB)" << std::endl;
+            converted++;
+        } else {
+            cached++;
+        }
+    }
+    std::cout << "Skeleton cache: " << converted << " converted, " << cached << " already cached, " << failed
+              << " skipped" << std::endl;
+    return failed;
+}
+
+unsigned char *SkeletonCache::readEntry(const std::string &path, unsigned long long hash, int *binaryLength)
+{
+    int length = 0;
+    unsigned char *binary = (unsigned char *) SpineExtension::readFile(path.c_str(), &length);
+    if (!binary) return nullptr;
+
+    // The binary starts with the hash it was converted with, as two big endian ints, low half first, and the entry
+    // ends with a hash of the binary. A truncated, corrupt or foreign file is treated as missing and overwritten.
+    bool valid = length >= 16;
+    if (valid) {
+        unsigned long long stored = 0, check = 0;
+        for (int i = 0; i < 8; i++) {
+            stored = stored << 8 | binary[i < 4 ? i + 4 : i - 4];
+            check = check << 8 | binary[length - 8 + i];
+        }
+        valid = stored == hash && check == SkeletonJsonConverter::contentHash((const char *) binary, length - 8);
+    }
+    if (!valid) {
+        SpineExtension::free(binary, __FILE__, __LINE__);
+        return nullptr;
+    }
+    *binaryLength = length - 8;
+    return binary;
+}
+
+bool SkeletonCache::writeEntry(const std::string &path, const unsigned char *binary, int binaryLength)
+{
+    if (!makeDirectories(parentDirectory(path))) {
+        error = "Failed to create skeleton cache directory: " + parentDirectory(path);
+        return false;
+    }
+    // Written next to the entry and renamed, so a concurrent load never sees a partial file.
+    std::string temp = path + ".tmp";
+    FILE *file = fopen(temp.c_str(), "wb");
+    if (!file) {
+        error = "Failed to write skeleton cache: " + path;
+        return false;
+    }
+    unsigned long long check = SkeletonJsonConverter::contentHash((const char *) binary, binaryLength);
+    unsigned char trailer[8];
+    for (int i = 0; i < 8; i++) trailer[i] = (unsigned char) (check >> (56 - i * 8));
+    bool written = fwrite(binary, 1, binaryLength, file) == (size_t) binaryLength && fwrite(trailer, 1, 8, file) == 8;
+    written = fclose(file) == 0 && written;
+    if (written && rename(temp.c_str(), path.c_str()) != 0) {
+        // Windows doesn't replace existing files.
+        remove(path.c_str());
+        written = rename(temp.c_str(), path.c_str()) == 0;
+    }
+    if (!written) {
+        remove(temp.c_str());
+        error = "Failed to write skeleton cache: " + path;
+    }
+    return written;
+}
+
+bool SkeletonCache::convert(const std::string &jsonPath, const char *json, int length, unsigned long long hash)
+{
+    if (converter.convert(json, length, hash)) return true;
+    error = std::string("Can't convert ") + jsonPath + " to binary: " + converter.getError().buffer();
+    return false;
+}
+
+#endif
@@ -0,0 +1,48 @@
+
+#pragma once
+
+#include <string>
+
+#include "spine/spine.h"
+#include "spine/Version.h"
+
+#if SPINE_MAJOR_VERSION >= 4
+
+/// Binary copies of skeleton JSON files, converted with SkeletonJsonConverter so later loads can use SkeletonBinary
+/// instead of parsing the JSON. Each entry is named after the JSON file, the hash of its content and the runtime
+/// version, so an edited JSON or a different runtime never picks up a stale entry. SkeletonBinary ignores trailing
+/// data, so entries end with a hash of the binary that detects truncated or corrupt files.
+class SkeletonCache {
+public:
+    /// Entries go to the given directory, or to a ".spinecache" directory next to each JSON file if it is empty.
+    explicit SkeletonCache(const std::string &directory = "");
+
+    /// Returns the binary for the JSON, read from the cache or converted and written to it. Returns nullptr if the
+    /// JSON can't be converted, in which case it has to be loaded with SkeletonJson. The caller frees the binary with
+    /// SpineExtension::free.
+    unsigned char *load(const std::string &jsonPath, const char *json, int length, int *binaryLength);
+
+    /// Converts the JSON file and writes it to the cache unless the cache already has it.
+    /// @param converted Set to whether a new entry was written.
+    bool prewarm(const std::string &jsonPath, bool *converted);
+
+    /// Prewarms every .json file in the directory and its subdirectories, skipping hidden ones, and prints a
+    /// summary. Returns the number of files that couldn't be converted.
+    int prewarmDirectory(const std::string &directory);
+
+    /// The path of the entry for JSON with the given content.
+    std::string entryPath(const std::string &jsonPath, unsigned long long hash) const;
+
+    const std::string &getError() const { return error; }
+
+private:
+    std::string directory;
+    std::string error;
+    spine::SkeletonJsonConverter converter;
+
+    unsigned char *readEntry(const std::string &path, unsigned long long hash, int *binaryLength);
+    bool writeEntry(const std::string &path, const unsigned char *binary, int binaryLength);
+    bool convert(const std::string &jsonPath, const char *json, int length, unsigned long long hash);
+};
+
+#endif
@@ -0,0 +1,293 @@
+
+#include "SpineArena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace spine;
+
+// Every allocation is preceded by a header holding its size, so realloc knows how much to copy, and
+// the arena it came from, or null for the heap, so free finds its owner without a lookup.
+struct AllocationHeader {
+    size_t size;
+    SpineArena *arena;
+};
+
+static const size_t HEADER_SIZE = 16;
+static const size_t ALIGNMENT = 16;
+
+static_assert(sizeof(AllocationHeader) <= HEADER_SIZE, "The allocation header must fit in HEADER_SIZE");
+
+static inline size_t alignSize(size_t size) {
+    return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+static inline AllocationHeader &allocationHeader(void *ptr) {
+    return *(AllocationHeader *) ((uint8_t *) ptr - HEADER_SIZE);
+}
+
+static inline size_t &allocationSize(void *ptr) {
+    return allocationHeader(ptr).size;
+}
+
+// The arena allocations on this thread go to, see SpineArenaExtension::beginArena().
+static thread_local SpineArena *active = nullptr;
+
+// How deeply this thread is nested in SpineExtension::beginTemporary().
+static thread_local int temporaryDepth = 0;
+
+// Heap blocks up to this size are rounded up to a multiple of ALIGNMENT. Freed ones are kept by the freeing thread
+// for its next allocation of the same size, so threads loading and updating skeletons at once don't contend on malloc
+// for the many small vectors and strings of the runtime.
+static const size_t CACHED_SIZE_LIMIT = 256;
+static const size_t CACHE_CLASSES = CACHED_SIZE_LIMIT / ALIGNMENT;
+static const unsigned int CACHE_LIMIT = 64;
+
+// The capacity of a heap block for an allocation of the given size.
+static inline size_t heapCapacity(size_t size) {
+    return size <= CACHED_SIZE_LIMIT ? alignSize(size) : size;
+}
+
+// Per thread lists of freed heap blocks, linked through their first bytes, one for each size class.
+struct HeapCache {
+    void *blocks[CACHE_CLASSES] = {};
+    unsigned int counts[CACHE_CLASSES] = {};
+
+    ~HeapCache() {
+        for (size_t c = 0; c < CACHE_CLASSES; c++) {
+            while (blocks[c]) {
+                void *next = *(void **) blocks[c];
+                ::free((uint8_t *) blocks[c] - HEADER_SIZE);
+                blocks[c] = next;
+            }
+            // Blocks freed while the thread exits go straight back to the heap.
+            counts[c] = CACHE_LIMIT;
+        }
+    }
+};
+
+static thread_local HeapCache heapCache;
+
+SpineArena::SpineArena(size_t chunkSize) : chunkSize(chunkSize)
+{
+}
+
+SpineArena::~SpineArena()
+{
+    for (size_t i = 0; i < chunks.size(); i++) {
+        ::free(chunks[i].memory);
+    }
+}
+
+void SpineArena::report(const char *label) const
+{
+    printf("%s: %zu allocations, %zu reallocations, %zu frees, %.1f KB used of %.1f KB in %zu chunks, %.1f%% fragmentation\n",
+           label, stats.allocations, stats.reallocations, stats.frees,
+           stats.usedBytes / 1024.0, stats.reservedBytes / 1024.0, stats.chunks,
+           stats.fragmentation() * 100.0f);
+}
+
+void *SpineArena::allocate(size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t needed = HEADER_SIZE + alignSize(size);
+    Chunk *newChunk = nullptr;
+    if (chunks.empty() || chunks.back().used + needed > chunks.back().capacity) {
+        Chunk chunk;
+        chunk.capacity = needed > chunkSize ? needed : chunkSize;
+        chunk.memory = (uint8_t *) ::malloc(chunk.capacity);
+        chunk.used = 0;
+        if (!chunk.memory) return nullptr;
+        // Keep the tail of the current chunk for small allocations when an oversized one arrives.
+        if (needed > chunkSize && !chunks.empty()) {
+            chunks.insert(chunks.end() - 1, chunk);
+            newChunk = &chunks[chunks.size() - 2];
+        } else {
+            chunks.push_back(chunk);
+            newChunk = &chunks.back();
+        }
+        stats.chunks++;
+        stats.reservedBytes += chunk.capacity;
+    }
+    Chunk &chunk = newChunk ? *newChunk : chunks.back();
+    void *ptr = chunk.memory + chunk.used + HEADER_SIZE;
+    chunk.used += needed;
+    allocationHeader(ptr).size = size;
+    allocationHeader(ptr).arena = this;
+    stats.usedBytes += needed;
+    stats.allocations++;
+    return ptr;
+}
+
+bool SpineArena::resizeInPlace(void *ptr, size_t size)
+{
+    // Only the most recent allocation of the current chunk can grow or shrink in place.
+    std::lock_guard<std::mutex> lock(mutex);
+    if (chunks.empty()) return false;
+    Chunk &chunk = chunks.back();
+    size_t oldSize = alignSize(allocationSize(ptr));
+    if ((uint8_t *) ptr + oldSize != chunk.memory + chunk.used) return false;
+    size_t newSize = alignSize(size);
+    if (chunk.used - oldSize + newSize > chunk.capacity) return false;
+    chunk.used = chunk.used - oldSize + newSize;
+    stats.usedBytes = stats.usedBytes - oldSize + newSize;
+    stats.reallocations++;
+    allocationSize(ptr) = size;
+    return true;
+}
+
+void SpineArena::release(void *ptr)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.frees++;
+    size_t size = HEADER_SIZE + alignSize(allocationSize(ptr));
+    Chunk &chunk = chunks.back();
+    if ((uint8_t *) ptr - HEADER_SIZE + size == chunk.memory + chunk.used) {
+        // Freeing the most recent allocation simply rewinds the bump pointer.
+        chunk.used -= size;
+        stats.usedBytes -= size;
+    } else {
+        stats.freedBytes += size;
+    }
+}
+
+SpineArenaExtension::SpineArenaExtension() : DefaultSpineExtension()
+{
+}
+
+SpineArenaExtension::~SpineArenaExtension()
+{
+}
+
+SpineArena *SpineArenaExtension::beginArena()
+{
+    active = new SpineArena();
+    return active;
+}
+
+void SpineArenaExtension::endArena()
+{
+    active = nullptr;
+}
+
+void SpineArenaExtension::releaseArena(SpineArena *arena)
+{
+    if (!arena) return;
+    if (active == arena) active = nullptr;
+    delete arena;
+}
+
+bool SpineArenaExtension::useArena() const
+{
+    return active && temporaryDepth == 0;
+}
+
+void *SpineArenaExtension::allocateHeap(size_t size)
+{
+    size_t capacity = heapCapacity(size);
+    void *ptr = nullptr;
+    if (capacity <= CACHED_SIZE_LIMIT) {
+        size_t sizeClass = capacity / ALIGNMENT - 1;
+        ptr = heapCache.blocks[sizeClass];
+        if (ptr) {
+            heapCache.blocks[sizeClass] = *(void **) ptr;
+            heapCache.counts[sizeClass]--;
+        }
+    }
+    if (!ptr) {
+        uint8_t *memory = (uint8_t *) ::malloc(HEADER_SIZE + capacity);
+        if (!memory) return nullptr;
+        ptr = memory + HEADER_SIZE;
+    }
+    allocationHeader(ptr).size = size;
+    allocationHeader(ptr).arena = nullptr;
+    return ptr;
+}
+
+void SpineArenaExtension::freeHeap(void *ptr)
+{
+    size_t capacity = heapCapacity(allocationSize(ptr));
+    if (capacity <= CACHED_SIZE_LIMIT) {
+        size_t sizeClass = capacity / ALIGNMENT - 1;
+        if (heapCache.counts[sizeClass] < CACHE_LIMIT) {
+            *(void **) ptr = heapCache.blocks[sizeClass];
+            heapCache.blocks[sizeClass] = ptr;
+            heapCache.counts[sizeClass]++;
+            return;
+        }
+    }
+    ::free((uint8_t *) ptr - HEADER_SIZE);
+}
+
+void *SpineArenaExtension::_alloc(size_t size, const char *file, int line)
+{
+    SP_UNUSED(file);
+    SP_UNUSED(line);
+    if (size == 0) return nullptr;
+    return useArena() ? active->allocate(size) : allocateHeap(size);
+}
+
+void *SpineArenaExtension::_calloc(size_t size, const char *file, int line)
+{
+    void *ptr = _alloc(size, file, line);
+    if (ptr) memset(ptr, 0, size);
+    return ptr;
+}
+
+void *SpineArenaExtension::_realloc(void *ptr, size_t size, const char *file, int line)
+{
+    if (!ptr) return _alloc(size, file, line);
+    SpineArena *owner = allocationHeader(ptr).arena;
+    if (size == 0) {
+        _free(ptr, file, line);
+        return nullptr;
+    }
+    if (!owner) {
+        if (heapCapacity(size) == heapCapacity(allocationSize(ptr))) {
+            allocationSize(ptr) = size;
+            return ptr;
+        }
+        uint8_t *memory = (uint8_t *) ::realloc((uint8_t *) ptr - HEADER_SIZE, HEADER_SIZE + heapCapacity(size));
+        if (!memory) return nullptr;
+        ptr = memory + HEADER_SIZE;
+        allocationSize(ptr) = size;
+        return ptr;
+    }
+    if (owner == active && owner->resizeInPlace(ptr, size)) return ptr;
+
+    // Move the block, either to the end of the active arena or to the heap once loading is done.
+    size_t oldSize = allocationSize(ptr);
+    void *moved = _alloc(size, file, line);
+    if (!moved) return nullptr;
+    memcpy(moved, ptr, oldSize < size ? oldSize : size);
+    owner->release(ptr);
+    if (owner == active) {
+        std::lock_guard<std::mutex> lock(owner->mutex);
+        owner->stats.reallocations++;
+    }
+    return moved;
+}
+
+void SpineArenaExtension::_free(void *mem, const char *file, int line)
+{
+    SP_UNUSED(file);
+    SP_UNUSED(line);
+    if (!mem) return;
+    SpineArena *owner = allocationHeader(mem).arena;
+    if (owner) {
+        owner->release(mem);
+    } else {
+        freeHeap(mem);
+    }
+}
+
+void SpineArenaExtension::_beginTemporary()
+{
+    temporaryDepth++;
+}
+
+void SpineArenaExtension::_endTemporary()
+{
+    temporaryDepth--;
+}
@@ -0,0 +1,97 @@
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+#include "spine/spine.h"
+
+/// Counters describing how an arena was used. "freed" is memory the runtime released back to the
+/// arena; it is only reclaimed when the whole arena is released.
+struct SpineArenaStats {
+    size_t chunks = 0;
+    size_t reservedBytes = 0;
+    size_t usedBytes = 0;
+    size_t freedBytes = 0;
+    size_t allocations = 0;
+    size_t reallocations = 0;
+    size_t frees = 0;
+
+    /// Share of the used bytes that were released again, i.e. dead space inside the arena.
+    float fragmentation() const { return usedBytes ? (float) freedBytes / (float) usedBytes : 0.0f; }
+};
+
+/// A bump allocator holding every allocation made while loading one SkeletonData. Individual frees
+/// are only counted; the memory is returned in one shot when the arena is released. Allocations and
+/// frees may come from different threads, e.g. a skeleton loaded on a worker and disposed on the main
+/// thread, so they are serialized by the arena's mutex.
+class SpineArena {
+    friend class SpineArenaExtension;
+
+public:
+    explicit SpineArena(size_t chunkSize = 1024 * 1024);
+    ~SpineArena();
+
+    const SpineArenaStats &getStats() const { return stats; }
+
+    /// Prints the arena statistics prefixed by the given label.
+    void report(const char *label) const;
+
+private:
+    struct Chunk {
+        uint8_t *memory;
+        size_t capacity;
+        size_t used;
+    };
+
+    std::vector<Chunk> chunks;
+    size_t chunkSize;
+    SpineArenaStats stats;
+    std::mutex mutex;
+
+    void *allocate(size_t size);
+    bool resizeInPlace(void *ptr, size_t size);
+    void release(void *ptr);
+};
+
+/// A SpineExtension that routes allocations into the active SpineArena, and everything else to the
+/// heap. Temporary allocations, see SpineExtension::beginTemporary(), always go to the heap, since
+/// the JSON document is freed as soon as parsing finishes and would only leave dead space in the
+/// arena. The active arena is per thread, so a skeleton can load on a worker while the render thread
+/// allocates from the heap. Heap allocations carry the same header as arena ones, naming their owner,
+/// so only memory allocated through this extension may be freed or reallocated through it. Small
+/// heap blocks are kept in a per thread cache when freed and handed out again by the next allocation
+/// of the same size class on that thread.
+class SpineArenaExtension : public spine::DefaultSpineExtension {
+public:
+    SpineArenaExtension();
+    virtual ~SpineArenaExtension();
+
+    /// Creates an arena and makes it the target of all following allocations on this thread until endArena().
+    SpineArena *beginArena();
+
+    void endArena();
+
+    /// Frees the arena and all its memory. Everything allocated in it must have been deleted.
+    void releaseArena(SpineArena *arena);
+
+protected:
+    virtual void *_alloc(size_t size, const char *file, int line) override;
+
+    virtual void *_calloc(size_t size, const char *file, int line) override;
+
+    virtual void *_realloc(void *ptr, size_t size, const char *file, int line) override;
+
+    virtual void _free(void *mem, const char *file, int line) override;
+
+    virtual void _beginTemporary() override;
+
+    virtual void _endTemporary() override;
+
+private:
+    void *allocateHeap(size_t size);
+    void freeHeap(void *ptr);
+    bool useArena() const;
+};
@@ -1,8 +1,26 @@
 
 #include "SpineManager.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <string>
 #include <iostream>
+#include <thread>
+
+#include "stb_image.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <stdio.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 using namespace spine;
@@ -10,23 +28,227 @@ using namespace spine;
 extern int width, height;
 extern renderer_t *g_renderer;
 
+/// The current resident set size of the process in KB, 0 if unknown.
+static long residentKB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return (long) (counters.WorkingSetSize / 1024);
+#elif defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count) != KERN_SUCCESS) return 0;
+    return (long) (info.resident_size / 1024);
+#else
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (!file) return 0;
+    long size = 0, resident = 0;
+    int read = fscanf(file, "%ld %ld", &size, &resident);
+    fclose(file);
+    if (read != 2) return 0;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
+
+#if SPINE_MAJOR_VERSION >= 4
+/// Creates atlas pages from the decoded pixels in an asset package, falling back to the image files for pages the
+/// package doesn't have.
+class PackageTextureLoader : public GlTextureLoader {
+public:
+    explicit PackageTextureLoader(const AssetPackage &package) : package(package) {}
+
+    void load(AtlasPage &page, const String &path) {
+        const AssetPackage::Page *packed = package.findPage(page.name);
+        if (!packed) {
+            GlTextureLoader::load(page, path);
+            return;
+        }
+        page.texture = (void *) (uintptr_t) texture_create(packed->width, packed->height, packed->channels,
+                                                            packed->pixels);
+    }
+
+private:
+    const AssetPackage &package;
+};
+#endif
+
+/// Reads the skeleton data from a .json or .skel file with the caller's configured readers. Everything the skeleton
+/// data allocates while parsing goes into a new arena when the SpineArenaExtension is installed, freed in dispose().
+static SkeletonData *readSkeletonData(const std::string &skelPath, SkeletonJson &json, SkeletonBinary &binary,
+#if SPINE_MAJOR_VERSION >= 4
+                                      SkeletonCache *cache,
+#endif
+                                      SpineArena *&arena) {
+    bool isJson = skelPath.find(".json") != std::string::npos;
+    int length = 0;
+    char *buffer = nullptr;
+#if SPINE_MAJOR_VERSION >= 4
+    // Binary skeletons are mapped by readSkeletonDataFile() rather than read into memory here.
+    if (isJson)
+#endif
+    {
+        buffer = SpineExtension::readFile(skelPath.c_str(), &length);
+        if (!buffer) {
+            std::cerr << "Failed to read skeleton file: " << skelPath << std::endl;
+            return nullptr;
+        }
+    }
+#if SPINE_MAJOR_VERSION >= 4
+    // JSON is replaced by its cached binary conversion, made before the arena so it isn't kept there.
+    if (isJson && cache) {
+        int binaryLength = 0;
+        unsigned char *converted = cache->load(skelPath, buffer, length, &binaryLength);
+        if (converted) {
+            SpineExtension::free(buffer, __FILE__, __LINE__);
+            buffer = (char *) converted;
+            length = binaryLength;
+            isJson = false;
+        } else {
+            std::cerr << cache->getError() << ", loading the JSON" << std::endl;
+        }
+    }
+#endif
+
+    SpineArenaExtension *arenaExtension = dynamic_cast<SpineArenaExtension *>(SpineExtension::getInstance());
+    if (arenaExtension) arena = arenaExtension->beginArena();
+    SkeletonData *skeletonData;
+    /* .json / .skel */
+    if (isJson)
+        skeletonData = json.readSkeletonData(buffer);
+    else if (buffer)
+        skeletonData = binary.readSkeletonData((const unsigned char *) buffer, length);
+    else
+        skeletonData = binary.readSkeletonDataFile(skelPath.c_str());
+    if (arenaExtension) {
+        arenaExtension->endArena();
+        arena->report("Skeleton data arena");
+    }
+    if (buffer) SpineExtension::free(buffer, __FILE__, __LINE__);
+    return skeletonData;
+}
+
+#if SPINE_MAJOR_VERSION >= 4
+/// A skeleton loading on a worker thread, see SpineManager::loadSpineAsync(). The worker owns it until finished is
+/// set, after that it belongs to the render thread, which uploads the decoded pages and deletes what it doesn't take.
+struct SpineLoad {
+    /// An atlas page image decoded by the worker, uploaded by the render thread.
+    struct Page {
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        unsigned char *pixels = nullptr;
+    };
+
+    std::string atlasPath;
+    std::string skelPath;
+    bool lazyAnimations = false;
+    bool lazySkins = false;
+    bool sparseDeform = false;
+    bool useCache = true;
+    TextureLoader *textureLoader = nullptr;
+
+    std::thread thread;
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> finished{false};
+    std::atomic<float> progress{0};
+    std::atomic<const char *> stage{"Waiting"};
+
+    Atlas *atlas = nullptr;
+    std::vector<Page> pages;
+    SkeletonData *skeletonData = nullptr;
+    SpineArena *arena = nullptr;
+
+    ~SpineLoad() {
+        if (thread.joinable()) thread.join();
+        delete skeletonData;
+        if (arena) {
+            SpineArenaExtension *arenaExtension = dynamic_cast<SpineArenaExtension *>(SpineExtension::getInstance());
+            if (arenaExtension) arenaExtension->releaseArena(arena);
+        }
+        // Unloads the pages' textures, so this must run on the render thread.
+        delete atlas;
+        for (size_t i = 0; i < pages.size(); i++) stbi_image_free(pages[i].pixels);
+    }
+
+    /// Reads the atlas, decodes its pages and reads the skeleton data, stopping at the next step once cancelled.
+    /// Textures aren't created, GL calls are left to the render thread.
+    void run() {
+        stage = "Reading atlas";
+        atlas = new Atlas(atlasPath.c_str(), textureLoader, false);
+        Vector<AtlasPage *> &atlasPages = atlas->getPages();
+        stage = "Decoding atlas pages";
+        for (size_t i = 0; i < atlasPages.size(); i++) {
+            if (cancelled) {
+                finished = true;
+                return;
+            }
+            progress = 0.5f * i / atlasPages.size();
+            Page page;
+            page.pixels = stbi_load(atlasPages[i]->texturePath.buffer(), &page.width, &page.height, &page.channels, 0);
+            if (!page.pixels) std::cerr << "Failed to load texture: " << atlasPages[i]->texturePath.buffer() << std::endl;
+            pages.push_back(page);
+        }
+        if (cancelled) {
+            finished = true;
+            return;
+        }
+
+        // The parse itself can't be interrupted, a load cancelled during it is dropped when it's done.
+        stage = "Reading skeleton";
+        progress = 0.5f;
+        SkeletonCache cache;
+        SkeletonJson json(atlas);
+        SkeletonBinary binary(atlas);
+        json.setLazyAnimations(lazyAnimations);
+        json.setLazySkins(lazySkins);
+        binary.setLazyAnimations(lazyAnimations);
+        binary.setLazySkins(lazySkins);
+        json.setSparseDeform(sparseDeform);
+        binary.setSparseDeform(sparseDeform);
+        skeletonData = readSkeletonData(skelPath, json, binary, useCache ? &cache : nullptr, arena);
+        progress = 1;
+        stage = "Done";
+        finished = true;
+    }
+};
+#endif
+
 SpineManager::SpineManager() : atlas(nullptr), skeletonData(nullptr), skeleton(nullptr), 
-                    animationStateData(nullptr), animationState(nullptr), textureLoader(nullptr)
+                    animationStateData(nullptr), animationState(nullptr), textureLoader(nullptr), arena(nullptr)
 {
     textureLoader = new GlTextureLoader();
+#if SPINE_MAJOR_VERSION >= 4
+    trigMode = MathUtil::getTrigMode();
+    snapshots = new SnapshotCache(30, 64);
+    packageTextureLoader = new PackageTextureLoader(package);
+#endif
 }
     
 SpineManager::~SpineManager() {
+#if SPINE_MAJOR_VERSION >= 4
+    cancelLoading();
+    for (size_t i = 0; i < cancelledLoads.size(); i++) delete cancelledLoads[i];
+    cancelledLoads.clear();
+#endif
     dispose();
     if (textureLoader) {
         delete textureLoader;
         textureLoader = nullptr;
     }
+#if SPINE_MAJOR_VERSION >= 4
+    delete snapshots;
+    delete packageTextureLoader;
+#endif
 }
     
 bool SpineManager::loadSpine(const std::string& atlasPath, const std::string& skelPath) {
     // Dispose previous resources
     dispose();
+#if SPINE_MAJOR_VERSION >= 4
+    cancelLoading();
+    this->skelPath = skelPath;
+#endif
+    long residentBefore = residentKB();
         
     // Load the atlas and the skeleton data
     atlas = new Atlas(atlasPath.c_str(), textureLoader);
@@ -39,28 +261,158 @@ bool SpineManager::loadSpine(const std::string& atlasPath, const std::string& sk
 #if SPINE_MAJOR_VERSION == 3
     _atlasAttachmentLoader = new (__FILE__, __LINE__) Cocos2dAtlasAttachmentLoader(atlas);
 #endif
-    /* .json / .skel */
-    if (skelPath.find(".json") != std::string::npos) {
 #if SPINE_MAJOR_VERSION == 3
-        SkeletonJson json(_atlasAttachmentLoader);
+    SkeletonJson json(_atlasAttachmentLoader);
+    SkeletonBinary binary(_atlasAttachmentLoader);
+    skeletonData = readSkeletonData(skelPath, json, binary, arena);
 #else
-        SkeletonJson json(atlas);
-#endif
-        skeletonData = json.readSkeletonDataFile(skelPath.c_str());
-    } else {
-#if SPINE_MAJOR_VERSION == 3
-        SkeletonBinary binary(_atlasAttachmentLoader);
-#else
-        SkeletonBinary binary(atlas);
+    SkeletonJson json(atlas);
+    SkeletonBinary binary(atlas);
+    json.setLazyAnimations(lazyAnimations);
+    json.setLazySkins(lazySkins);
+    binary.setLazyAnimations(lazyAnimations);
+    binary.setLazySkins(lazySkins);
+    json.setSparseDeform(sparseDeform);
+    binary.setSparseDeform(sparseDeform);
+    skeletonData = readSkeletonData(skelPath, json, binary, skeletonCache ? &cache : nullptr, arena);
 #endif
-        skeletonData = binary.readSkeletonDataFile(skelPath.c_str());
-    }
     if (!skeletonData) {
         std::cerr << "Failed to load skeleton data: " << skelPath << std::endl;
         dispose();
         return false;
     }
-    
+    long residentAfter = residentKB();
+    std::cout << "RSS " << residentBefore / 1024.0 << " MB before loading, " << residentAfter / 1024.0
+              << " MB after (" << (residentAfter - residentBefore) / 1024.0 << " MB for this skeleton)" << std::endl;
+    return createSkeleton();
+}
+
+#if SPINE_MAJOR_VERSION >= 4
+bool SpineManager::loadPackage(const std::string& packagePath) {
+    dispose();
+    cancelLoading();
+    this->skelPath = packagePath;
+    auto start = std::chrono::steady_clock::now();
+    if (!package.open(packagePath)) {
+        std::cerr << package.getError() << std::endl;
+        return false;
+    }
+
+    // Page names are looked up in the package, the directory is only used for pages it doesn't have.
+    size_t slash = packagePath.find_last_of("/\\");
+    std::string dir = slash == std::string::npos ? "" : packagePath.substr(0, slash);
+    atlas = new Atlas(package.getAtlas(), package.getAtlasLength(), dir.c_str(), packageTextureLoader);
+
+    SpineArenaExtension *arenaExtension = dynamic_cast<SpineArenaExtension *>(SpineExtension::getInstance());
+    SkeletonBinary binary(atlas);
+    binary.setLazyAnimations(lazyAnimations);
+    binary.setLazySkins(lazySkins);
+    binary.setSparseDeform(sparseDeform);
+    binary.setBorrowBinary(true);
+    if (arenaExtension) arena = arenaExtension->beginArena();
+    skeletonData = binary.readSkeletonData(package.getSkeleton(), package.getSkeletonLength());
+    if (arenaExtension) {
+        arenaExtension->endArena();
+        arena->report("Skeleton data arena");
+    }
+    if (!skeletonData) {
+        std::cerr << "Failed to load skeleton data from " << packagePath << ": " << binary.getError().buffer()
+                  << std::endl;
+        dispose();
+        return false;
+    }
+    std::cout << "Loaded package in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms"
+              << std::endl;
+    return createSkeleton();
+}
+
+void SpineManager::loadSpineAsync(const std::string& atlasPath, const std::string& skelPath) {
+    cancelLoading();
+    SpineLoad *load = new SpineLoad();
+    load->atlasPath = atlasPath;
+    load->skelPath = skelPath;
+    load->lazyAnimations = lazyAnimations;
+    load->lazySkins = lazySkins;
+    load->sparseDeform = sparseDeform;
+    load->useCache = skeletonCache;
+    load->textureLoader = textureLoader;
+    load->thread = std::thread(&SpineLoad::run, load);
+    pendingLoad = load;
+}
+
+void SpineManager::cancelLoading() {
+    if (!pendingLoad) return;
+    pendingLoad->cancelled = true;
+    cancelledLoads.push_back(pendingLoad);
+    pendingLoad = nullptr;
+}
+
+bool SpineManager::finishLoading() {
+    for (size_t i = 0; i < cancelledLoads.size();) {
+        if (cancelledLoads[i]->finished) {
+            delete cancelledLoads[i];
+            cancelledLoads.erase(cancelledLoads.begin() + i);
+        } else {
+            i++;
+        }
+    }
+    if (!pendingLoad || !pendingLoad->finished) return false;
+    SpineLoad *load = pendingLoad;
+    pendingLoad = nullptr;
+    load->thread.join();
+    if (!load->skeletonData) {
+        std::cerr << "Failed to load skeleton data: " << load->skelPath << std::endl;
+        delete load;
+        return false;
+    }
+
+    Vector<AtlasPage *> &pages = load->atlas->getPages();
+    for (size_t i = 0; i < pages.size(); i++) {
+        const SpineLoad::Page &page = load->pages[i];
+        if (page.pixels)
+            pages[i]->texture = (void *) (uintptr_t) texture_create(page.width, page.height, page.channels, page.pixels);
+    }
+    // Regions copied their page's texture when the atlas was read.
+    Vector<AtlasRegion *> &regions = load->atlas->getRegions();
+    for (size_t i = 0; i < regions.size(); i++) regions[i]->rendererObject = regions[i]->page->texture;
+
+    // The current skeleton is only replaced once the new one is ready.
+    dispose();
+    atlas = load->atlas;
+    skeletonData = load->skeletonData;
+    arena = load->arena;
+    skelPath = load->skelPath;
+    load->atlas = nullptr;
+    load->skeletonData = nullptr;
+    load->arena = nullptr;
+    delete load;
+    return createSkeleton();
+}
+
+bool SpineManager::isLoading() const {
+    return pendingLoad != nullptr;
+}
+
+float SpineManager::getLoadProgress() const {
+    return pendingLoad ? pendingLoad->progress.load() : 0;
+}
+
+const char *SpineManager::getLoadStage() const {
+    return pendingLoad ? pendingLoad->stage.load() : "";
+}
+#endif
+
+bool SpineManager::createSkeleton() {
+#if SPINE_MAJOR_VERSION >= 4
+    if (quantizeKeys) {
+        skeletonData->quantizeAnimations(quantizeError, quantizeReport);
+        std::cout << "Quantized " << quantizeReport.quantized << " timelines, kept " << quantizeReport.skipped
+                  << ": keys " << quantizeReport.bytesBefore / 1024.0 << " KB -> " << quantizeReport.bytesAfter / 1024.0
+                  << " KB, max error " << quantizeReport.maxTimeError << " s, " << quantizeReport.maxValueError
+                  << " value, " << quantizeReport.maxDeformError << " deform" << std::endl;
+    }
+#endif
     // Create a skeleton from the data
     skeleton = new Skeleton(skeletonData);
     if (!skeleton) {
@@ -78,6 +430,11 @@ bool SpineManager::loadSpine(const std::string& atlasPath, const std::string& sk
     skeleton->setPosition(spinePosX, spinePosY);
     skeleton->setScaleX(scalex);
     skeleton->setScaleY(scaley);
+    setBoneBatching(boneBatching);
+#if SPINE_MAJOR_VERSION >= 4
+    setPathTolerance(pathTolerance);
+    setPhysicsBatching(physicsBatching);
+#endif
 
     auto &animations = skeletonData->getAnimations();
     std::cout << "Loaded " << animations.size() << " animations:" << std::endl;
@@ -110,6 +467,9 @@ bool SpineManager::loadSpine(const std::string& atlasPath, const std::string& sk
         // animationState->setAnimation(0, firstAnim->getName(), spineLoop);
         setAnimationByName(firstAnim->getName().buffer(), spineLoop);
     }
+#if SPINE_MAJOR_VERSION >= 4
+    setBakedPlayback(bakedPlayback);
+#endif
     
     return true;
 }
@@ -117,11 +477,24 @@ bool SpineManager::loadSpine(const std::string& atlasPath, const std::string& sk
 void SpineManager::update(float delta) {
     if (animationState && skeleton) {
         animationState->update(delta);
-        animationState->apply(*skeleton);
-        skeleton->update(delta);
 #if SPINE_MAJOR_VERSION >= 4
-       skeleton->updateWorldTransform(spine::Physics_Update);
+        TrackEntry *entry = bakedPlayback && bake ? animationState->getCurrent(0) : nullptr;
+        int baked = entry ? bake->findAnimation(entry->getAnimation()->getName()) : -1;
+        if (baked >= 0) {
+            // The baked frames replace timelines, constraints and physics. Mixing is not baked.
+            skeleton->update(delta);
+            bake->apply(*skeleton, baked, entry->getTrackTime(), entry->getLoop());
+        } else {
+            animationState->apply(*skeleton);
+            skeleton->update(delta);
+            skeleton->updateWorldTransform(spine::Physics_Update);
+        }
+        playbackTime += delta;
+        playbackEnd = std::max(playbackEnd, playbackTime);
+        snapshots->frame(*skeleton, animationState, playbackTime);
 #else
+        animationState->apply(*skeleton);
+        skeleton->update(delta);
         skeleton->updateWorldTransform();
 #endif
 
@@ -165,6 +538,11 @@ void SpineManager::setTimeScale(float scale)
     if (!animationState) {
         return;
     }
+#if SPINE_MAJOR_VERSION >= 4
+    // Playback after the current time no longer matches the snapshots.
+    snapshots->clear();
+    playbackEnd = playbackTime;
+#endif
 
     Vector<TrackEntry*>& tracks = animationState->getTracks();
     for (size_t i = 0; i < tracks.size(); ++i) {
@@ -175,6 +553,128 @@ void SpineManager::setTimeScale(float scale)
     }
 }
     
+void SpineManager::setBoneBatching(bool enabled)
+{
+    boneBatching = enabled;
+#if SPINE_MAJOR_VERSION >= 4
+    if (skeleton) {
+        skeleton->setBoneBatching(enabled);
+    }
+#endif
+}
+    
+#if SPINE_MAJOR_VERSION >= 4
+void SpineManager::setTrigMode(int mode)
+{
+    trigMode = mode;
+    MathUtil::setTrigMode((TrigMode) mode);
+}
+
+void SpineManager::setPathTolerance(float tolerance)
+{
+    pathTolerance = tolerance;
+    if (skeleton) {
+        Vector<PathConstraint *> &constraints = skeleton->getPathConstraints();
+        for (size_t i = 0; i < constraints.size(); i++) {
+            constraints[i]->setSubdivisionTolerance(tolerance);
+        }
+    }
+}
+
+void SpineManager::setPhysicsBatching(int mode)
+{
+    physicsBatching = mode;
+    if (skeleton) {
+        skeleton->setPhysicsBatching((PhysicsBatching) mode);
+    }
+}
+
+void SpineManager::seek(float time)
+{
+    if (!skeleton || !animationState) return;
+    time = std::max(time, 0.0f);
+    float restored = snapshots->restore(*skeleton, animationState, time);
+    if (restored >= 0) {
+        playbackTime = restored;
+    } else {
+        // Nothing to start from, play the current animation again from the setup pose.
+        TrackEntry *current = animationState->getCurrent(0);
+        if (!current) return;
+        std::string name = current->getAnimation()->getName().buffer();
+        bool loop = current->getLoop();
+        animationState->clearTracks();
+        skeleton->setToSetupPose();
+        skeleton->setTime(0);
+        setAnimationByName(name, loop);
+        skeleton->updateWorldTransform(spine::Physics_Reset);
+        update(0);
+    }
+
+    const float step = 1 / 60.0f;
+    while (time - playbackTime > 0.0001f) {
+        update(std::min(step, time - playbackTime));
+    }
+}
+
+void SpineManager::setBakedPlayback(bool enabled)
+{
+    bakedPlayback = enabled;
+    if (!enabled || bake || !skeletonData) return;
+    std::string path = skelPath + ".bake";
+    bake = AnimationBake::load(path.c_str(), skeletonData);
+    if (!bake) {
+        bake = AnimationBake::bake(skeletonData, skeleton->getSkin(), 30);
+        if (bake && !bake->write(path.c_str())) {
+            std::cerr << "Failed to write animation bake: " << path << std::endl;
+        }
+    }
+    if (bake) {
+        std::cout << "Animation bake: " << bake->getByteSize() << " bytes" << (bake->isMapped() ? ", mapped" : "")
+                  << ", max position error " << bake->getPositionError() << std::endl;
+    }
+}
+
+void SpineManager::collectWorldVertices(std::vector<float> &vertices)
+{
+    vertices.clear();
+    Vector<Slot *> &drawOrder = skeleton->getDrawOrder();
+    for (size_t i = 0; i < drawOrder.size(); ++i) {
+        Slot *slot = drawOrder[i];
+        Attachment *attachment = slot->getAttachment();
+        if (!attachment || !slot->getBone().isActive()) continue;
+        size_t offset = vertices.size();
+        if (attachment->getRTTI().isExactly(RegionAttachment::rtti)) {
+            vertices.resize(offset + 8);
+            static_cast<RegionAttachment *>(attachment)->computeWorldVertices(*slot, vertices.data(), offset, 2);
+        } else if (attachment->getRTTI().isExactly(MeshAttachment::rtti)) {
+            MeshAttachment *mesh = static_cast<MeshAttachment *>(attachment);
+            vertices.resize(offset + mesh->getWorldVerticesLength());
+            mesh->computeWorldVertices(*slot, 0, mesh->getWorldVerticesLength(), vertices.data(), offset, 2);
+        }
+    }
+}
+
+float SpineManager::measureTrigError()
+{
+    if (!skeleton) return 0;
+    TrigMode mode = MathUtil::getTrigMode();
+    std::vector<float> precise, approximate;
+    MathUtil::setTrigMode(TrigMode_Precise);
+    skeleton->updateWorldTransform(spine::Physics_Pose);
+    collectWorldVertices(precise);
+    MathUtil::setTrigMode(mode);
+    skeleton->updateWorldTransform(spine::Physics_Pose);
+    collectWorldVertices(approximate);
+
+    float maxError = 0;
+    for (size_t i = 0; i + 1 < precise.size() && i + 1 < approximate.size(); i += 2) {
+        float dx = precise[i] - approximate[i], dy = precise[i + 1] - approximate[i + 1];
+        maxError = std::max(maxError, std::sqrt(dx * dx + dy * dy));
+    }
+    return maxError;
+}
+#endif
+    
 void SpineManager::dispose()
 {
     if (animationState) {
@@ -189,14 +689,32 @@ void SpineManager::dispose()
         delete skeleton;
         skeleton = nullptr;
     }
+#if SPINE_MAJOR_VERSION >= 4
+    if (bake) {
+        delete bake;
+        bake = nullptr;
+    }
+    // Snapshots point at the skeleton data's attachments and the state's track entries.
+    snapshots->clear();
+    playbackTime = playbackEnd = 0;
+    quantizeReport = QuantizeReport();
+#endif
     if (skeletonData) {
         delete skeletonData;
         skeletonData = nullptr;
     }
+    if (arena) {
+        SpineArenaExtension *arenaExtension = dynamic_cast<SpineArenaExtension *>(SpineExtension::getInstance());
+        if (arenaExtension) arenaExtension->releaseArena(arena);
+        arena = nullptr;
+    }
     if (atlas) {
         delete atlas;
         atlas = nullptr;
     }
+#if SPINE_MAJOR_VERSION >= 4
+    package.close();
+#endif
 }
     
 bool SpineManager::isLoaded() const
@@ -211,6 +729,10 @@ void SpineManager::setAnimationByName(const std::string& name, bool loop)
         if (animation) {
             TrackEntry *entry = animationState->setAnimation(0, name.c_str(), loop);
             entry->setTimeScale(spineEntryTimeScale);
+#if SPINE_MAJOR_VERSION >= 4
+            snapshots->clear();
+            playbackTime = playbackEnd = 0;
+#endif
 
         } else {
             std::cerr << "Animation not found: " << name << std::endl;
@@ -8,10 +8,17 @@
 #include "spine/spine.h"
 #include "spine/Version.h"
 #include "spine-glfw.h"
+#include "SpineArena.h"
+#include "SkeletonCache.h"
+#include "AssetPackage.h"
 
 using namespace std;
 using namespace spine;
 
+#if SPINE_MAJOR_VERSION >= 4
+struct SpineLoad;
+#endif
+
 class SpineManager {
 public:
     bool premultipliedAlpha = true;
@@ -24,6 +31,29 @@ public:
     float spinePosX = 0;
     float spinePosY = 0;
     float spineEntryTimeScale = 1.0;
+    bool boneBatching = false;
+#if SPINE_MAJOR_VERSION >= 4
+    int trigMode = TrigMode_Precise;
+    float pathTolerance = 0;
+    int physicsBatching = PhysicsBatching_None;
+    /// Seconds played since the current animation was set, see seek().
+    float playbackTime = 0;
+    /// The furthest playbackTime reached, the end of the range seek() can restore without replaying.
+    float playbackEnd = 0;
+    /// Plays animations from an AnimationBake stored next to the skeleton file instead of evaluating them.
+    bool bakedPlayback = false;
+    /// Loads JSON skeletons from a binary conversion kept in the SkeletonCache, converting them on the first load.
+    bool skeletonCache = true;
+    /// Reads each animation's timelines when it is first played instead of when the skeleton is loaded.
+    bool lazyAnimations = false;
+    /// Reads the attachments of each skin other than the default skin when it is first used.
+    bool lazySkins = false;
+    /// Stores deform keys only for the vertices they move, see SkeletonBinary::setSparseDeform.
+    bool sparseDeform = true;
+    /// Stores the keyframes in 16 bits after loading where they stay within quantizeError, see Animation::quantize.
+    bool quantizeKeys = false;
+    float quantizeError = 0.01f;
+#endif
 
 private:
     Atlas *atlas;
@@ -32,16 +62,63 @@ private:
     AnimationStateData *animationStateData;
     AnimationState *animationState;
     GlTextureLoader *textureLoader;
+    SpineArena *arena;
     
 #if SPINE_MAJOR_VERSION == 3
     Cocos2dAtlasAttachmentLoader *_atlasAttachmentLoader = nullptr;
 #endif
+
+#if SPINE_MAJOR_VERSION >= 4
+    SnapshotCache *snapshots;
+    AnimationBake *bake = nullptr;
+    std::string skelPath;
+    SkeletonCache cache;
+    QuantizeReport quantizeReport;
+    /// The package the current skeleton was loaded from, closed when it's disposed.
+    AssetPackage package;
+    /// Creates the atlas pages from the package's pixels.
+    GlTextureLoader *packageTextureLoader;
+    /// The load started by loadSpineAsync(), null once finishLoading() took it.
+    SpineLoad *pendingLoad = nullptr;
+    /// Cancelled loads whose worker may still be running, deleted by finishLoading() once it's done.
+    std::vector<SpineLoad *> cancelledLoads;
+
+    void collectWorldVertices(std::vector<float> &vertices);
+#endif
+
+    /// Creates the skeleton and animation state for the loaded skeleton data. Disposes everything if that fails.
+    bool createSkeleton();
     
 public:
     SpineManager();
     ~SpineManager();
     
     bool loadSpine(const std::string& atlasPath, const std::string& skelPath);
+
+#if SPINE_MAJOR_VERSION >= 4
+    /// Loads the skeleton, atlas and textures from an asset package written with AssetPackage::write. The package
+    /// stays mapped while the skeleton is loaded, lazy animations and skins are read from it.
+    bool loadPackage(const std::string& packagePath);
+
+    /// Starts loading on a worker thread, cancelling the load in progress. The atlas pages are decoded and the
+    /// skeleton data read there, the current skeleton keeps playing until finishLoading() replaces it.
+    void loadSpineAsync(const std::string& atlasPath, const std::string& skelPath);
+
+    /// Drops the load in progress. A worker still parsing finishes in the background and its result is discarded.
+    void cancelLoading();
+
+    /// Called every frame on the render thread. When the pending load is done, uploads its textures and swaps it in
+    /// for the current skeleton. Returns true if a new skeleton was swapped in.
+    bool finishLoading();
+
+    bool isLoading() const;
+
+    /// How far the pending load is, from 0 to 1.
+    float getLoadProgress() const;
+
+    /// What the pending load is doing, for display.
+    const char *getLoadStage() const;
+#endif
     
     void update(float delta);
     
@@ -54,11 +131,46 @@ public:
     void setScaleY(float y);
 
     void setTimeScale(float scale);
+
+    /// Toggles the SIMD bone update path, see Skeleton::setBoneBatching. Only available for 4.x runtimes.
+    void setBoneBatching(bool enabled);
+
+#if SPINE_MAJOR_VERSION >= 4
+    /// Selects the MathUtil trig implementation, see TrigMode.
+    void setTrigMode(int mode);
+
+    /// Poses the skeleton with precise and with the current trig mode and returns the largest distance between
+    /// the resulting world vertices, in pixels.
+    float measureTrigError();
+
+    /// Sets the adaptive subdivision tolerance of all path constraints, see PathConstraint::setSubdivisionTolerance.
+    void setPathTolerance(float tolerance);
+
+    /// Selects how physics constraints are stepped, see Skeleton::setPhysicsBatching.
+    void setPhysicsBatching(int mode);
+
+    /// Moves playback of the current animation to the given playbackTime. The pose is restored from the closest
+    /// snapshot taken during playback and simulated forward in 1/60 s steps, so physics settle as if played.
+    void seek(float time);
+
+    /// Toggles baked playback. Enabling it loads the bake next to the skeleton file, baking and writing it first
+    /// if it is missing or was baked from different skeleton data.
+    void setBakedPlayback(bool enabled);
+
+    /// The bake used for baked playback, null until enabled.
+    AnimationBake *getBake() const { return bake; }
+
+    /// What quantizeKeys did to the loaded skeleton data. Animations loaded lazily afterwards aren't included.
+    const QuantizeReport &getQuantizeReport() const { return quantizeReport; }
+#endif
     
     void dispose();
     
     bool isLoaded() const;
 
+    /// The arena holding the current skeleton data, or null when the default extension is in use.
+    const SpineArena *getArena() const { return arena; }
+
     void setAnimationByName(const std::string& name, bool loop);
 
     void setX(float x);
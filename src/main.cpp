@@ -12,6 +12,11 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #define GL_SILENCE_DEPRECATION
 #if defined(IMGUI_IMPL_OPENGL_ES2)
 #include <GLES2/gl2.h>
@@ -70,6 +75,17 @@ static void drop_callback(GLFWwindow* window, int count, const char** paths) {
 		std::cout << "Dropped file: " << paths[i] << std::endl;
 		std::string filepath(paths[i]);
 		
+#if SPINE_MAJOR_VERSION >= 4
+		// A package holds the atlas and skeleton itself.
+		if (filepath.find(".spkg") != std::string::npos) {
+			if (g_spineManager && g_spineManager->loadPackage(filepath)) {
+				std::cout << "Spine package loaded successfully!" << std::endl;
+			} else {
+				std::cout << "Failed to load Spine package!" << std::endl;
+			}
+			return;
+		}
+#endif
 		if (filepath.find(".atlas") != std::string::npos) {
 			atlasPath = filepath;
 		} else if (filepath.find(".skel") != std::string::npos || 
@@ -84,11 +100,16 @@ static void drop_callback(GLFWwindow* window, int count, const char** paths) {
 		std::cout << "Atlas: " << atlasPath << std::endl;
 		std::cout << "Skeleton: " << skelPath << std::endl;
 		
+#if SPINE_MAJOR_VERSION >= 4
+		// Loads on a worker so the UI keeps running, the main loop swaps the skeleton in when it's done.
+		g_spineManager->loadSpineAsync(atlasPath, skelPath);
+#else
 		if (g_spineManager->loadSpine(atlasPath, skelPath)) {
 			std::cout << "Spine animation loaded successfully!" << std::endl;
 		} else {
 			std::cout << "Failed to load Spine animation!" << std::endl;
 		}
+#endif
 	} else if (!atlasPath.empty() || !skelPath.empty()) {
 		std::cout << "Please drop both .atlas and .skel/.json files to load a complete Spine animation" << std::endl;
 	}
@@ -103,9 +124,299 @@ static void glfw_error_callback(int error, const char* description)
 #endif
 }
 
+#if SPINE_MAJOR_VERSION >= 4
+/// Reads skeleton data the way SpineManager does, into an arena of the calling thread.
+static SkeletonData *readStressData(Atlas &atlas, const std::string &skelPath, bool lazy, SpineArena *&arena) {
+    SkeletonJson json(&atlas);
+    SkeletonBinary binary(&atlas);
+    json.setLazyAnimations(lazy);
+    json.setLazySkins(lazy);
+    binary.setLazyAnimations(lazy);
+    binary.setLazySkins(lazy);
+    SpineArenaExtension *arenaExtension = dynamic_cast<SpineArenaExtension *>(SpineExtension::getInstance());
+    if (arenaExtension) arena = arenaExtension->beginArena();
+    SkeletonData *data;
+    if (skelPath.find(".json") != std::string::npos) {
+        int length = 0;
+        char *buffer = SpineExtension::readFile(skelPath.c_str(), &length);
+        data = buffer ? json.readSkeletonData(buffer) : nullptr;
+        SpineExtension::free(buffer, __FILE__, __LINE__);
+    } else {
+        data = binary.readSkeletonDataFile(skelPath.c_str());
+    }
+    if (arenaExtension) arenaExtension->endArena();
+    return data;
+}
+
+/// Plays every animation and skin of a skeleton for a second.
+static void playStressSkeleton(Skeleton &skeleton) {
+    AnimationStateData stateData(skeleton.getData());
+    AnimationState state(&stateData);
+    Vector<Animation *> &animations = skeleton.getData()->getAnimations();
+    Vector<Skin *> &skins = skeleton.getData()->getSkins();
+    for (size_t i = 0; i < animations.size(); i++) {
+        if (skins.size()) skeleton.setSkin(skins[i % skins.size()]);
+        skeleton.setSlotsToSetupPose();
+        state.setAnimation(0, animations[i], true);
+        for (int frame = 0; frame < 60; frame++) {
+            state.update(1 / 60.0f);
+            state.apply(skeleton);
+            skeleton.update(1 / 60.0f);
+            skeleton.updateWorldTransform(Physics_Update);
+        }
+    }
+}
+
+/// Poses a y up and a y down skeleton of the data the same way and returns whether every bone of one is the mirror of
+/// the other, which only holds if each skeleton uses its own y down setting. Bones of skins not set, and their
+/// children, aren't checked.
+static bool isMirroredYDown(SkeletonData *data) {
+    Skeleton up(data), down(data);
+    up.setYDown(false);
+    down.setYDown(true);
+    Vector<Animation *> &animations = data->getAnimations();
+    Skeleton *skeletons[] = {&up, &down};
+    for (int i = 0; i < 2; i++) {
+        if (animations.size())
+            animations[0]->apply(*skeletons[i], 0, 0.5f, true, nullptr, 1, MixBlend_Setup, MixDirection_In);
+        skeletons[i]->updateWorldTransform(Physics_Pose);
+    }
+    for (size_t i = 0; i < up.getBones().size(); i++) {
+        Bone *a = up.getBones()[i], *b = down.getBones()[i];
+        bool active = true;
+        for (Bone *bone = a; bone && active; bone = bone->getParent()) active = bone->isActive();
+        if (!active) continue;
+        if (fabsf(a->getWorldY() + b->getWorldY()) > 1e-3f || fabsf(a->getC() + b->getC()) > 1e-3f ||
+            fabsf(a->getD() + b->getD()) > 1e-3f || fabsf(a->getWorldX() - b->getWorldX()) > 1e-3f)
+            return false;
+    }
+    return true;
+}
+
+/// "--stress <atlas> <skeleton> [threads]" loads and plays the skeleton on many threads at once and exits, meant for
+/// ThreadSanitizer builds. Each thread loads its own skeleton data and also plays skeletons of one shared, lazily read
+/// SkeletonData, so first uses of its animations and skins race. Textures aren't created.
+static int stressTest(const char *atlasPath, const char *skelPath, int threadCount) {
+    Atlas atlas(atlasPath, nullptr, false);
+    SpineArena *sharedArena = nullptr;
+    SkeletonData *shared = readStressData(atlas, skelPath, true, sharedArena);
+    if (!shared) {
+        std::cerr << "Failed to load skeleton data: " << skelPath << std::endl;
+        return 1;
+    }
+
+    std::atomic<int> failures(0), mirrorFailures(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.push_back(std::thread([&, t]() {
+            // Alternate lazy and full reads, y down and up, so every thread doesn't take the same path.
+            SpineArena *arena = nullptr;
+            SkeletonData *own = readStressData(atlas, skelPath, t % 2 == 0, arena);
+            if (!own) {
+                failures++;
+                return;
+            }
+            if (!isMirroredYDown(shared)) mirrorFailures++;
+            Skeleton sharedSkeleton(shared);
+            sharedSkeleton.setYDown(t % 2 == 0);
+            playStressSkeleton(sharedSkeleton);
+            Skeleton *clone = sharedSkeleton.clone();
+            playStressSkeleton(*clone);
+            delete clone;
+            {
+                Skeleton ownSkeleton(own);
+                playStressSkeleton(ownSkeleton);
+            }
+            delete own;
+            SpineArenaExtension *arenaExtension = dynamic_cast<SpineArenaExtension *>(SpineExtension::getInstance());
+            if (arenaExtension) arenaExtension->releaseArena(arena);
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    std::cout << threadCount << " threads in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+              << " ms, " << failures << " failed to load, " << mirrorFailures << " not mirrored by y down" << std::endl;
+
+    delete shared;
+    SpineArenaExtension *arenaExtension = dynamic_cast<SpineArenaExtension *>(SpineExtension::getInstance());
+    if (arenaExtension) arenaExtension->releaseArena(sharedArena);
+    return failures || mirrorFailures ? 1 : 0;
+}
+
+/// A skeleton with bezier curves on the two color timelines, whose curves sit past those of the light color, checked by
+/// "--roundtrip" when no files are given.
+static const char *ROUND_TRIP_SKELETON = R"({
+ "skeleton": { "spine": "4.2.40" },
+ "bones": [ { "name": "root" }, { "name": "arm", "parent": "root", "length": 10 } ],
+ "slots": [
+  { "name": "rgb2", "bone": "arm", "dark": "000000" },
+  { "name": "rgba2", "bone": "arm", "dark": "000000" }
+ ],
+ "animations": {
+  "colors": {
+   "slots": {
+    "rgb2": {
+     "rgb2": [
+      { "light": "ff0000", "dark": "00ff00",
+        "curve": [ 0.1, 0.9, 0.4, 0.1, 0.1, 0.2, 0.4, 0.8, 0.1, 0.5, 0.4, 0.5, 0.1, 0.9, 0.4, 0.1, 0.1, 0.2, 0.4, 0.8, 0.1, 0.5, 0.4, 0.5 ] },
+      { "time": 0.5, "light": "00ff00", "dark": "0000ff",
+        "curve": [ 0.6, 0.3, 0.9, 0.8, 0.6, 0.7, 0.9, 0.2, 0.6, 0.1, 0.9, 0.9, 0.6, 0.3, 0.9, 0.8, 0.6, 0.7, 0.9, 0.2, 0.6, 0.1, 0.9, 0.9 ] },
+      { "time": 1, "light": "0000ff", "dark": "ff0000" }
+     ]
+    },
+    "rgba2": {
+     "rgba2": [
+      { "light": "ff0000ff", "dark": "00ff00",
+        "curve": [ 0.25, 0.1, 0.75, 0.9, 0.25, 0.9, 0.75, 0.1, 0.25, 0.4, 0.75, 0.6, 0.25, 0.2, 0.75, 0.3, 0.25, 0.1, 0.75, 0.9, 0.25, 0.9, 0.75, 0.1, 0.25, 0.4, 0.75, 0.6 ] },
+      { "time": 1, "light": "00ff0080", "dark": "0000ff" }
+     ]
+    }
+   },
+   "bones": {
+    "arm": { "rotate": [ { "curve": [ 0.25, 30, 0.75, 60 ] }, { "time": 1, "value": 90 } ] }
+   }
+  }
+ }
+})";
+
+static int countMismatch(float expected, float actual) {
+    return fabsf(expected - actual) > 1e-5f ? 1 : 0;
+}
+
+/// Applies every animation of the expected skeleton's data and its match in the actual one at the same times and
+/// counts the bone transforms, slot colors and deform values that differ.
+static int comparePoses(Skeleton &expected, Skeleton &actual) {
+    int mismatches = 0;
+    Vector<Animation *> &animations = expected.getData()->getAnimations();
+    for (size_t i = 0; i < animations.size(); i++) {
+        Animation *animation = animations[i];
+        Animation *match = actual.getData()->findAnimation(animation->getName());
+        if (!match) {
+            std::cerr << "Animation missing after conversion: " << animation->getName().buffer() << std::endl;
+            mismatches++;
+            continue;
+        }
+        for (float time = 0; time <= animation->getDuration() + 1 / 120.0f; time += 1 / 60.0f) {
+            expected.setToSetupPose();
+            actual.setToSetupPose();
+            animation->apply(expected, time, time, false, nullptr, 1, MixBlend_Setup, MixDirection_In);
+            match->apply(actual, time, time, false, nullptr, 1, MixBlend_Setup, MixDirection_In);
+            expected.updateWorldTransform(Physics_Pose);
+            actual.updateWorldTransform(Physics_Pose);
+            int before = mismatches;
+            for (size_t b = 0; b < expected.getBones().size(); b++) {
+                Bone *e = expected.getBones()[b], *a = actual.getBones()[b];
+                mismatches += countMismatch(e->getA(), a->getA()) + countMismatch(e->getB(), a->getB()) +
+                              countMismatch(e->getC(), a->getC()) + countMismatch(e->getD(), a->getD()) +
+                              countMismatch(e->getWorldX(), a->getWorldX()) + countMismatch(e->getWorldY(), a->getWorldY());
+            }
+            for (size_t s = 0; s < expected.getSlots().size(); s++) {
+                Slot *e = expected.getSlots()[s], *a = actual.getSlots()[s];
+                Color &light = e->getColor(), &dark = e->getDarkColor();
+                mismatches += countMismatch(light.r, a->getColor().r) + countMismatch(light.g, a->getColor().g) +
+                              countMismatch(light.b, a->getColor().b) + countMismatch(light.a, a->getColor().a) +
+                              countMismatch(dark.r, a->getDarkColor().r) + countMismatch(dark.g, a->getDarkColor().g) +
+                              countMismatch(dark.b, a->getDarkColor().b);
+                Vector<float> &deform = e->getDeform();
+                if (deform.size() != a->getDeform().size()) {
+                    mismatches++;
+                    continue;
+                }
+                for (size_t v = 0; v < deform.size(); v++) mismatches += countMismatch(deform[v], a->getDeform()[v]);
+            }
+            if (mismatches != before)
+                std::cerr << animation->getName().buffer() << " differs at " << time << " s" << std::endl;
+        }
+    }
+    return mismatches;
+}
+
+/// "--roundtrip [<atlas> <skeleton.json>]" converts the JSON to binary the way the skeleton cache does, loads both and
+/// compares the poses of every animation in every skin, then exits. Without files it checks ROUND_TRIP_SKELETON.
+static int roundTripTest(const char *atlasPath, const char *jsonPath) {
+    Atlas *atlas = atlasPath ? new Atlas(atlasPath, nullptr, false) : new Atlas("", 0, "", nullptr, false);
+    int length = 0;
+    char *text;
+    if (jsonPath) {
+        text = SpineExtension::readFile(jsonPath, &length);
+        if (!text) {
+            std::cerr << "Failed to read skeleton file: " << jsonPath << std::endl;
+            delete atlas;
+            return 1;
+        }
+        text = SpineExtension::realloc(text, length + 1, __FILE__, __LINE__);
+        text[length] = 0;
+    } else {
+        length = (int) strlen(ROUND_TRIP_SKELETON);
+        text = SpineExtension::alloc<char>(length + 1, __FILE__, __LINE__);
+        memcpy(text, ROUND_TRIP_SKELETON, length + 1);
+    }
+
+    SkeletonJson json(atlas);
+    SkeletonBinary binary(atlas);
+    SkeletonJsonConverter converter;
+    SkeletonData *jsonData = json.readSkeletonData(text);
+    SkeletonData *binaryData = nullptr;
+    if (!jsonData)
+        std::cerr << "Failed to load skeleton JSON: " << json.getError().buffer() << std::endl;
+    else if (!converter.convert(text, length, 0))
+        std::cerr << "Failed to convert skeleton JSON: " << converter.getError().buffer() << std::endl;
+    else if (!(binaryData = binary.readSkeletonData(converter.getBinary(), converter.getBinaryLength())))
+        std::cerr << "Failed to load converted skeleton: " << binary.getError().buffer() << std::endl;
+    SpineExtension::free(text, __FILE__, __LINE__);
+
+    int mismatches = -1;
+    if (binaryData) {
+        Skeleton expected(jsonData), actual(binaryData);
+        mismatches = 0;
+        Vector<Skin *> &skins = jsonData->getSkins();
+        for (size_t i = 0; i == 0 || i < skins.size(); i++) {
+            if (skins.size()) {
+                expected.setSkin(skins[i]);
+                actual.setSkin(binaryData->findSkin(skins[i]->getName()));
+            }
+            mismatches += comparePoses(expected, actual);
+        }
+        std::cout << mismatches << " mismatches" << std::endl;
+    }
+    delete binaryData;
+    delete jsonData;
+    delete atlas;
+    return mismatches == 0 ? 0 : 1;
+}
+#endif
+
 // Main code
-int main(int, char**)
+int main(int argc, char** argv)
 {
+#if SPINE_MAJOR_VERSION >= 4
+    // "--prewarm <directory>" converts every skeleton JSON below the directory into the skeleton cache and exits.
+    if (argc >= 3 && strcmp(argv[1], "--prewarm") == 0) {
+        SkeletonCache cache;
+        return cache.prewarmDirectory(argv[2]) == 0 ? 0 : 1;
+    }
+    // "--package <atlas> <skeleton> <output.spkg>" writes an asset package for the atlas and skeleton and exits.
+    if (argc >= 5 && strcmp(argv[1], "--package") == 0) {
+        AssetPackage package;
+        if (!package.write(argv[2], argv[3], argv[4])) {
+            std::cerr << package.getError() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (argc >= 4 && strcmp(argv[1], "--stress") == 0) {
+        int threads = argc >= 5 ? atoi(argv[4]) : (int) std::thread::hardware_concurrency();
+        return stressTest(argv[2], argv[3], threads > 0 ? threads : 8);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--roundtrip") == 0) {
+        return roundTripTest(argc >= 4 ? argv[2] : nullptr, argc >= 4 ? argv[3] : nullptr);
+    }
+#else
+    SP_UNUSED(argc);
+    SP_UNUSED(argv);
+#endif
+
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit())
         return 1;
@@ -242,6 +553,11 @@ int main(int, char**)
 
 		// Update spine animation
 		if (g_spineManager) {
+#if SPINE_MAJOR_VERSION >= 4
+			if (g_spineManager->finishLoading()) {
+				std::cout << "Spine animation loaded successfully!" << std::endl;
+			}
+#endif
 			g_spineManager->update(delta);
 		}
 
@@ -261,6 +577,52 @@ int main(int, char**)
             ImGui::Checkbox("premultipliedAlpha", &g_spineManager->premultipliedAlpha);      // Edit bools storing our window open/close state
 
             ImGui::Text("Draw calls: %u", g_spineManager->drawcall);
+#if SPINE_MAJOR_VERSION >= 4
+            if (g_spineManager->isLoading()) {
+                ImGui::ProgressBar(g_spineManager->getLoadProgress(), ImVec2(-1, 0), g_spineManager->getLoadStage());
+                if (ImGui::Button("Cancel loading")) g_spineManager->cancelLoading();
+            }
+#endif
+            if (const SpineArena *arena = g_spineManager->getArena()) {
+                const SpineArenaStats &stats = arena->getStats();
+                ImGui::Text("Data arena: %.1f KB, %.1f%% fragmented", stats.usedBytes / 1024.0f, stats.fragmentation() * 100.0f);
+            }
+#if SPINE_MAJOR_VERSION >= 4
+            if (ImGui::Checkbox("Bone batching", &g_spineManager->boneBatching))
+                g_spineManager->setBoneBatching(g_spineManager->boneBatching);
+            if (ImGui::Combo("Trig", &g_spineManager->trigMode, "Precise\0Fast\0Approximate\0"))
+                g_spineManager->setTrigMode(g_spineManager->trigMode);
+            if (g_spineManager->trigMode != TrigMode_Precise)
+                ImGui::Text("Max vertex error: %.4f px", g_spineManager->measureTrigError());
+            if (ImGui::DragFloat("Path tolerance", &g_spineManager->pathTolerance, 0.01f, 0.0f, 10.0f))
+                g_spineManager->setPathTolerance(g_spineManager->pathTolerance);
+            if (ImGui::Combo("Physics", &g_spineManager->physicsBatching, "Scalar\0SIMD\0Reference\0"))
+                g_spineManager->setPhysicsBatching(g_spineManager->physicsBatching);
+            if (ImGui::Checkbox("Baked playback", &g_spineManager->bakedPlayback))
+                g_spineManager->setBakedPlayback(g_spineManager->bakedPlayback);
+            if (g_spineManager->bakedPlayback && g_spineManager->getBake()) {
+                AnimationBake *bake = g_spineManager->getBake();
+                ImGui::Text("Bake: %.1f KB%s, error %.4f", bake->getByteSize() / 1024.0f, bake->isMapped() ? " mapped" : "", bake->getPositionError());
+            }
+            ImGui::Checkbox("Skeleton cache", &g_spineManager->skeletonCache);
+            ImGui::Checkbox("Lazy animations", &g_spineManager->lazyAnimations);
+            ImGui::Checkbox("Lazy skins", &g_spineManager->lazySkins);
+            ImGui::Checkbox("Quantize keys", &g_spineManager->quantizeKeys);
+            if (g_spineManager->quantizeKeys)
+                ImGui::DragFloat("Key error budget", &g_spineManager->quantizeError, 0.0001f, 0.0f, 1.0f, "%.4f");
+            const QuantizeReport &quantizeReport = g_spineManager->getQuantizeReport();
+            if (quantizeReport.bytesBefore) {
+                ImGui::Text("Keys: %.1f -> %.1f KB, %zu quantized, %zu kept", quantizeReport.bytesBefore / 1024.0f,
+                            quantizeReport.bytesAfter / 1024.0f, quantizeReport.quantized, quantizeReport.skipped);
+                ImGui::Text("Key error: %.5f s, %.5f value, %.5f deform", quantizeReport.maxTimeError,
+                            quantizeReport.maxValueError, quantizeReport.maxDeformError);
+            }
+            if (g_spineManager->isLoaded()) {
+                float seekTime = g_spineManager->playbackTime;
+                if (ImGui::SliderFloat("Seek", &seekTime, 0.0f, g_spineManager->playbackEnd, "%.2f s"))
+                    g_spineManager->seek(seekTime);
+            }
+#endif
             ImGui::Checkbox("Both", &scalexy);
             if (scalexy)
             {
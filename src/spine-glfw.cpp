@@ -28,6 +28,7 @@
  *****************************************************************************/
 
 #include "spine-glfw.h"
+#include "SpineArena.h"
 #include <cstdio>
 // #include <glbinding/gl/gl.h>
 #include "glad/glad.h"
@@ -41,7 +42,7 @@ using namespace spine;
 
 // Set the default extension used for memory allocations and file I/O
 SpineExtension *spine::getDefaultExtension() {
-    return new spine::DefaultSpineExtension();
+    return new SpineArenaExtension();
 }
 
 /// A blend mode, see https://en.esotericsoftware.com/spine-slots#Blending
@@ -204,26 +205,30 @@ texture_t texture_load(const char *file_path) {
         return 0;
     }
 
+    texture_t texture = texture_create(width, height, nrChannels, data);
+    stbi_image_free(data);
+    return texture;
+}
+
+texture_t texture_create(int width, int height, int channels, const unsigned char *pixels) {
     GLenum format = GL_RGBA;
-    if (nrChannels == 1)
+    if (channels == 1)
         format = GL_RED;
-    else if (nrChannels == 3)
+    else if (channels == 3)
         format = GL_RGB;
-    else if (nrChannels == 4)
+    else if (channels == 4)
         format = GL_RGBA;
 
     texture_t texture;
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
     glGenerateMipmap(GL_TEXTURE_2D);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_image_free(data);
     return texture;
 }
 
@@ -87,6 +87,9 @@ typedef unsigned int texture_t;
 /// Loads the given image and creates an OpenGL texture with default settings and auto-generated mipmap levels
 texture_t texture_load(const char *file_path);
 
+/// Creates an OpenGL texture like texture_load from decoded pixels with 1 (red), 3 (RGB) or 4 (RGBA) channels
+texture_t texture_create(int width, int height, int channels, const unsigned char *pixels);
+
 /// Binds the texture to texture unit 0
 void texture_use(texture_t texture);
 